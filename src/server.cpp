@@ -4,14 +4,19 @@
 namespace competition {
 
 CompetitionServer::CompetitionServer(boost::asio::io_context& io_context, short port,
-                int p_r, int p_w, int delta_t)
+                int p_r, int p_w, int delta_t,
+                uint64_t trace_sample_every, const std::string& trace_file)
     : io_context_(io_context)
     , acceptor_(io_context, tcp::endpoint(tcp::v4(), port))
     , reader_pool_(p_r)
     , writer_pool_(p_w)
     , competitor_queue_(10000)
     , delta_t_(delta_t)
-    , log_file_("server_log.txt") {
+    , log_file_("server_log.txt")
+    , tracer_(trace_sample_every, trace_file) {
+    // The constructing thread goes on to run io_context, where all socket
+    // handlers (and so the receive stage) execute.
+    tracer_.name_current_thread("io_context");
     start_accept();
     
     for (int i = 0; i < p_w; ++i) {
@@ -22,17 +27,23 @@ CompetitionServer::CompetitionServer(boost::asio::io_context& io_context, short
 }
 
 CompetitionServer::~CompetitionServer() {
-    is_running_ = false;
-    competitor_queue_.shutdown();
-    
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    for (auto& conn : active_connections_) {
-        conn->shutdown();
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        for (auto& conn : active_connections_) {
+            conn->shutdown();
+        }
+        active_connections_.clear();
     }
-    active_connections_.clear();
-    
+
     reader_pool_.join();
     writer_pool_.join();
+    tracer_.close();
+}
+
+void CompetitionServer::stop() {
+    is_running_ = false;
+    competitor_queue_.shutdown();
 }
 
 void CompetitionServer::start_accept() {
@@ -62,7 +73,8 @@ void CompetitionServer::handle_connection(std::shared_ptr<Connection> conn) {
     });
 }
 
-void CompetitionServer::process_competitor_data(const std::string& data, int country_id) {
+void CompetitionServer::process_competitor_data(const std::string& data, int country_id,
+                                                uint64_t trace_id) {
     std::vector<std::pair<int, int>> competitors;
     std::stringstream ss(data);
     std::string line;
@@ -70,11 +82,15 @@ void CompetitionServer::process_competitor_data(const std::string& data, int cou
     while (std::getline(ss, line)) {
         int id, score;
         if (sscanf(line.c_str(), "%d,%d", &id, &score) == 2) {
-            if (!competitor_queue_.push({country_id, id, score}, 
+            if (!competitor_queue_.push({country_id, id, score, trace_id},
                 std::chrono::milliseconds(100))) {
+                tracer_.mark_dropped(trace_id);
                 log_message("Queue full, dropping competitor data");
                 return;
             }
+            tracer_.mark_queued(trace_id);
+        } else {
+            tracer_.mark_dropped(trace_id);
         }
     }
     
@@ -95,7 +111,11 @@ std::shared_future<std::string> CompetitionServer::request_ranking(int country_i
 
     std::shared_ptr<std::promise<std::string>> promise = std::make_shared<std::promise<std::string>>();
 
-    boost::asio::post(writer_pool_, [this, promise]() {
+    // Every writer_pool_ thread is parked in process_queue() for the life of
+    // the server, so a ranking posted there would only run at shutdown.
+    // reader_pool_ threads are free once they have armed a connection's
+    // first read, so rankings are computed there.
+    boost::asio::post(reader_pool_, [this, promise]() {
         std::string ranking = calculate_rankings();
         promise->set_value(ranking);
     });
@@ -105,8 +125,10 @@ std::shared_future<std::string> CompetitionServer::request_ranking(int country_i
 
 std::string CompetitionServer::calculate_rankings() {
     std::vector<std::pair<int, int>> scores;
+    std::vector<uint64_t> traced;
     {
         std::lock_guard<std::mutex> lock(ranking_mutex_);
+        traced = tracer_.take_applied();
         country_scores_.clear();
         for (const auto& competitor : final_ranking_) {
             country_scores_[competitor.country_id] += competitor.score;
@@ -128,6 +150,7 @@ std::string CompetitionServer::calculate_rankings() {
         ranking_cache_.timestamp = std::chrono::steady_clock::now();
         ranking_cache_.ranking_data = ranking;
     }
+    tracer_.mark_served(traced);
 
     return ranking;
 }
@@ -191,24 +214,29 @@ void CompetitionServer::handle_messages(std::shared_ptr<Connection> conn, int co
             send_final_results(conn);
             remove_connection(conn);
         } else {
+            uint64_t trace_id = tracer_.begin_record(country_id);
             std::cout << "Processing competitor data from country " << country_id << std::endl;
-            process_competitor_data(msg, country_id);
+            process_competitor_data(msg, country_id, trace_id);
             handle_messages(conn, country_id);
         }
     });
 }
 
 void CompetitionServer::send_final_results(std::shared_ptr<Connection> conn) {
-    std::lock_guard<std::mutex> lock(ranking_mutex_);
-    save_final_rankings();
-    
-    std::ifstream competitor_file("final_competitors.txt");
     std::stringstream competitor_data;
-    competitor_data << competitor_file.rdbuf();
-    
-    std::ifstream country_file("final_countries.txt");
     std::stringstream country_data;
-    country_data << country_file.rdbuf();
+    {
+        std::lock_guard<std::mutex> lock(ranking_mutex_);
+        std::vector<uint64_t> traced = tracer_.take_applied();
+        save_final_rankings();
+
+        std::ifstream competitor_file("final_competitors.txt");
+        competitor_data << competitor_file.rdbuf();
+
+        std::ifstream country_file("final_countries.txt");
+        country_data << country_file.rdbuf();
+        tracer_.mark_served(traced);
+    }
 
     conn->async_write(competitor_data.str() + "\n" + country_data.str(),
         [](const boost::system::error_code&, std::size_t) {});
@@ -235,11 +263,14 @@ void CompetitionServer::save_final_rankings() {
 }
 
 void CompetitionServer::process_queue() {
+    tracer_.name_current_thread("writer");
     while (is_running_) {
         Competitor comp;
         if (competitor_queue_.try_pop(comp)) {
+            tracer_.mark_popped(comp.trace_id);
             std::lock_guard<std::mutex> lock(ranking_mutex_);
             final_ranking_.push_back(comp);
+            tracer_.mark_applied(comp.trace_id);
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
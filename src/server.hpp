@@ -1,5 +1,6 @@
 #pragma once
 
+#include "tracer.hpp"
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/strand.hpp>
@@ -28,6 +29,7 @@ struct Competitor {
   int country_id;
   int competitor_id;
   int score;
+  uint64_t trace_id = 0;
 };
 
 struct RankingCache {
@@ -152,12 +154,14 @@ private:
   std::atomic<bool> is_running_{true};
   std::mutex connections_mutex_;
   std::set<std::shared_ptr<Connection>> active_connections_;
+  Tracer tracer_;
 
   void start_accept();
   void handle_connection(std::shared_ptr<Connection> conn);
   void handle_client_data(std::shared_ptr<Connection> conn);
   void handle_messages(std::shared_ptr<Connection> conn, int country_id);
-  void process_competitor_data(const std::string &data, int country_id);
+  void process_competitor_data(const std::string &data, int country_id,
+                               uint64_t trace_id);
   std::shared_future<std::string> request_ranking(int country_id);
   std::string calculate_rankings();
   void send_final_results(std::shared_ptr<Connection> conn);
@@ -168,8 +172,14 @@ private:
 
 public:
   CompetitionServer(boost::asio::io_context &io_context, short port, int p_r,
-                    int p_w, int delta_t);
+                    int p_w, int delta_t, uint64_t trace_sample_every = 0,
+                    const std::string &trace_file = "server_trace.json");
   ~CompetitionServer();
+
+  // Releases the writer loops and stops re-arming accepts. Only touches
+  // atomics and the queue, so it may run while io_context is active;
+  // sockets are closed by the destructor once io_context has returned.
+  void stop();
 };
 
 } // namespace competition
\ No newline at end of file
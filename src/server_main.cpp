@@ -1,42 +1,70 @@
 #include "server.hpp"
 #include <iostream>
 #include <csignal>
-
-std::unique_ptr<competition::CompetitionServer> server_ptr;
-boost::asio::io_context io_context;
-
-void signal_handler(int signum) {
-    if (server_ptr) {
-        server_ptr.reset();
-    }
-    io_context.stop();
-    exit(signum);
-}
+#include <pthread.h>
+#include <thread>
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <p_r> <p_w> <delta_t>" << std::endl;
+    if (argc < 4 || argc > 6) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <p_r> <p_w> <delta_t> [trace_sample_every] [trace_file]" << std::endl;
         return 1;
     }
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Block the shutdown signals before any thread is created so every pool
+    // thread inherits the mask; they are collected synchronously by
+    // signal_thread below instead of interrupting whatever thread is running.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
     try {
         int p_r = std::stoi(argv[1]);
         int p_w = std::stoi(argv[2]);
         int delta_t = std::stoi(argv[3]);
+        long long trace_sample_arg = argc > 4 ? std::stoll(argv[4]) : 0;
+        if (trace_sample_arg < 0) {
+            std::cerr << "trace_sample_every must be >= 0" << std::endl;
+            return 1;
+        }
+        uint64_t trace_sample_every = static_cast<uint64_t>(trace_sample_arg);
+        std::string trace_file = argc > 5 ? argv[5] : "server_trace.json";
 
+        boost::asio::io_context io_context;
         boost::asio::io_context::work work(io_context);
-        
-        std::cout << "Starting server with p_r=" << p_r << " p_w=" << p_w 
+
+        std::cout << "Starting server with p_r=" << p_r << " p_w=" << p_w
                   << " delta_t=" << delta_t << std::endl;
-        
-        server_ptr = std::make_unique<competition::CompetitionServer>(io_context, 12345, p_r, p_w, delta_t);
-        io_context.run();
+        if (trace_sample_every > 0) {
+            std::cout << "Tracing every " << trace_sample_every
+                      << " record(s) to " << trace_file << std::endl;
+        }
+
+        competition::CompetitionServer server(
+            io_context, 12345, p_r, p_w, delta_t, trace_sample_every, trace_file);
+
+        std::thread signal_thread([&]() {
+            int signum = 0;
+            sigwait(&signals, &signum);
+            std::cout << "Shutting down on signal " << signum << std::endl;
+            server.stop();
+            io_context.stop();
+        });
+
+        try {
+            io_context.run();
+        } catch (...) {
+            signal_thread.detach();
+            throw;
+        }
+        signal_thread.join();
+        // The server (and its trace file) is torn down here, on the main
+        // thread, once io_context has returned.
     } catch (std::exception& e) {
         std::cerr << "Server error: " << e.what() << std::endl;
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
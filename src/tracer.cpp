@@ -0,0 +1,167 @@
+#include "tracer.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace competition {
+
+Tracer::Tracer(uint64_t sample_every, const std::string& output_path)
+    : sample_every_(sample_every)
+    , start_(clock::now()) {
+    if (!enabled()) return;
+    out_.open(output_path);
+    if (!out_) {
+        std::cerr << "Could not open trace file " << output_path << std::endl;
+        return;
+    }
+    out_ << "[\n";
+}
+
+int Tracer::current_tid() {
+    static std::atomic<int> next_tid{1};
+    thread_local int tid = next_tid++;
+    return tid;
+}
+
+int64_t Tracer::micros_since_start(clock::time_point tp) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(tp - start_).count();
+}
+
+void Tracer::write_complete(const char* name, clock::time_point from, clock::time_point to,
+                            int tid, uint64_t trace_id, int country_id) {
+    int64_t ts = micros_since_start(from);
+    out_ << "{\"name\":\"" << name << "\",\"cat\":\"record\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+         << ",\"ts\":" << ts << ",\"dur\":" << micros_since_start(to) - ts
+         << ",\"args\":{\"trace_id\":" << trace_id << ",\"country_id\":" << country_id << "}},\n";
+}
+
+void Tracer::write_async_begin(const char* name, clock::time_point at,
+                               uint64_t trace_id, int country_id) {
+    out_ << "{\"name\":\"" << name << "\",\"cat\":\"record\",\"ph\":\"b\",\"pid\":1,\"tid\":0"
+         << ",\"id\":" << trace_id << ",\"ts\":" << micros_since_start(at)
+         << ",\"args\":{\"trace_id\":" << trace_id << ",\"country_id\":" << country_id << "}},\n";
+}
+
+void Tracer::write_async_end(const char* name, clock::time_point at, uint64_t trace_id) {
+    out_ << "{\"name\":\"" << name << "\",\"cat\":\"record\",\"ph\":\"e\",\"pid\":1,\"tid\":0"
+         << ",\"id\":" << trace_id << ",\"ts\":" << micros_since_start(at) << "},\n";
+}
+
+void Tracer::write_queue_wait(uint64_t trace_id, const RecordState& state) {
+    write_async_begin("queue_wait", state.queued, trace_id, state.country_id);
+    write_async_end("queue_wait", state.popped, trace_id);
+}
+
+void Tracer::name_current_thread(const std::string& name) {
+    if (!enabled()) return;
+    int tid = current_tid();
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_ << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+         << ",\"args\":{\"name\":\"" << name << " " << tid << "\"}},\n";
+}
+
+uint64_t Tracer::begin_record(int country_id) {
+    if (!enabled() || record_counter_++ % sample_every_ != 0) {
+        return 0;
+    }
+    uint64_t trace_id = next_trace_id_++;
+    RecordState state{};
+    state.country_id = country_id;
+    state.received = clock::now();
+    state.reader_tid = current_tid();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.emplace(trace_id, state);
+    return trace_id;
+}
+
+void Tracer::mark_queued(uint64_t trace_id) {
+    if (trace_id == 0) return;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = in_flight_.find(trace_id);
+    if (it == in_flight_.end()) return;
+    RecordState& state = it->second;
+    // This runs after push() returns, so a writer may already have popped
+    // (or applied) the record; never let the stamp pass the pop.
+    state.queued = state.is_popped ? std::min(now, state.popped) : now;
+    state.is_queued = true;
+    write_complete("receive", state.received, state.queued,
+                   state.reader_tid, trace_id, state.country_id);
+    if (state.is_applied) {
+        write_queue_wait(trace_id, state);
+    }
+}
+
+void Tracer::mark_dropped(uint64_t trace_id) {
+    if (trace_id == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(trace_id);
+}
+
+void Tracer::mark_popped(uint64_t trace_id) {
+    if (trace_id == 0) return;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = in_flight_.find(trace_id);
+    if (it == in_flight_.end()) return;
+    it->second.popped = now;
+    it->second.is_popped = true;
+}
+
+void Tracer::mark_applied(uint64_t trace_id) {
+    if (trace_id == 0) return;
+    auto now = clock::now();
+    int tid = current_tid();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = in_flight_.find(trace_id);
+    if (it == in_flight_.end()) return;
+    RecordState& state = it->second;
+    state.applied = now;
+    state.is_applied = true;
+    if (state.is_queued) {
+        write_queue_wait(trace_id, state);
+    }
+    write_complete("apply", state.popped, now, tid, trace_id, state.country_id);
+    applied_unserved_.push_back(trace_id);
+}
+
+std::vector<uint64_t> Tracer::take_applied() {
+    std::vector<uint64_t> taken;
+    if (!enabled()) return taken;
+    std::lock_guard<std::mutex> lock(mutex_);
+    taken.swap(applied_unserved_);
+    return taken;
+}
+
+void Tracer::mark_served(const std::vector<uint64_t>& trace_ids) {
+    if (trace_ids.empty()) return;
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint64_t trace_id : trace_ids) {
+        auto it = in_flight_.find(trace_id);
+        if (it == in_flight_.end()) continue;
+        const RecordState& state = it->second;
+        // Both spans end at `now`, so write begins outer-first and ends
+        // inner-first to keep them nested for viewers that sort stably.
+        write_async_begin("end_to_end", state.received, trace_id, state.country_id);
+        write_async_begin("ranking_wait", state.applied, trace_id, state.country_id);
+        write_async_end("ranking_wait", now, trace_id);
+        write_async_end("end_to_end", now, trace_id);
+        in_flight_.erase(it);
+    }
+    out_.flush();
+}
+
+void Tracer::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!out_.is_open()) return;
+    // Trailing metadata event so the array has no dangling comma.
+    out_ << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+         << "\"args\":{\"name\":\"competition server\"}}\n]\n";
+    out_.close();
+    if (!in_flight_.empty()) {
+        std::cout << in_flight_.size() << " traced record(s) were never served" << std::endl;
+    }
+}
+
+} // namespace competition
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace competition {
+
+// Sampled per-record latency tracing. Clients send one "id,score" line per
+// record, and every sample_every-th record gets a trace id that is stamped
+// as it moves through the server. Events are appended to a Chrome
+// trace-event JSON array (load in chrome://tracing or Perfetto) as they
+// complete: work a thread did is a complete event on that thread, waiting
+// is an async event keyed by the trace id. With sample_every == 0 tracing
+// is disabled and every call returns after a single branch.
+class Tracer {
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct RecordState {
+    int country_id;
+    clock::time_point received;
+    clock::time_point queued;
+    clock::time_point popped;
+    clock::time_point applied;
+    int reader_tid;
+    bool is_queued = false;
+    bool is_popped = false;
+    bool is_applied = false;
+  };
+
+  const uint64_t sample_every_;
+  const clock::time_point start_;
+  std::atomic<uint64_t> record_counter_{0};
+  std::atomic<uint64_t> next_trace_id_{1};
+  std::mutex mutex_;
+  std::ofstream out_;
+  std::unordered_map<uint64_t, RecordState> in_flight_;
+  std::vector<uint64_t> applied_unserved_;
+
+  int64_t micros_since_start(clock::time_point tp) const;
+  void write_complete(const char *name, clock::time_point from,
+                      clock::time_point to, int tid, uint64_t trace_id,
+                      int country_id);
+  void write_async_begin(const char *name, clock::time_point at,
+                         uint64_t trace_id, int country_id);
+  void write_async_end(const char *name, clock::time_point at,
+                       uint64_t trace_id);
+  void write_queue_wait(uint64_t trace_id, const RecordState &state);
+  static int current_tid();
+
+public:
+  Tracer(uint64_t sample_every, const std::string &output_path);
+
+  bool enabled() const { return sample_every_ != 0; }
+
+  // Labels the calling thread's track, e.g. with the pool it belongs to.
+  void name_current_thread(const std::string &name);
+
+  // Returns a non-zero trace id if this record is sampled, 0 otherwise.
+  uint64_t begin_record(int country_id);
+  // Called once push() has succeeded; a failed push calls mark_dropped only.
+  void mark_queued(uint64_t trace_id);
+  void mark_dropped(uint64_t trace_id);
+  void mark_popped(uint64_t trace_id);
+  // Called by a writer with ranking_mutex_ held, right after applying.
+  void mark_applied(uint64_t trace_id);
+  // Called with ranking_mutex_ held while rankings are snapshotted; the
+  // returned ids are exactly the sampled records that snapshot includes.
+  std::vector<uint64_t> take_applied();
+  void mark_served(const std::vector<uint64_t> &trace_ids);
+
+  // Terminates the JSON array and closes the file. Not signal-safe.
+  void close();
+};
+
+} // namespace competition